@@ -0,0 +1,48 @@
+#include <cors.hpp>
+
+#include <userver/utest/using_namespace_userver.hpp>
+#include <userver/components/component_config.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+
+static const std::string kAllowOriginHeader = "Access-Control-Allow-Origin";
+static const std::string kAllowMethodsHeader = "Access-Control-Allow-Methods";
+static const std::string kAllowHeadersHeader = "Access-Control-Allow-Headers";
+
+Cors::Cors(const components::ComponentConfig& config,
+           const components::ComponentContext& context)
+    : components::LoggableComponentBase(config, context),
+      allow_origin_(config["allow-origin"].As<std::string>()),
+      allow_methods_(config["allow-methods"].As<std::string>("*")),
+      allow_headers_(config["allow-headers"].As<std::string>("content-type")) { }
+
+void Cors::SetHeaders(const server::http::HttpRequest& request) const {
+    auto& response = request.GetHttpResponse();
+    response.SetHeader(kAllowOriginHeader, allow_origin_);
+    response.SetHeader(kAllowMethodsHeader, allow_methods_);
+    response.SetHeader(kAllowHeadersHeader, allow_headers_);
+}
+
+yaml_config::Schema Cors::GetStaticConfigSchema() {
+    return yaml_config::MergeSchemas<components::LoggableComponentBase>(R"(
+type: object
+description: CORS headers for all handlers
+additionalProperties: false
+properties:
+    allow-origin:
+        type: string
+        description: Access-Control-Allow-Origin value
+    allow-methods:
+        type: string
+        description: Access-Control-Allow-Methods value
+        defaultDescription: '*'
+    allow-headers:
+        type: string
+        description: Access-Control-Allow-Headers value
+        defaultDescription: content-type
+)");
+}
+
+void AppendCors(userver::components::ComponentList& component_list) {
+    component_list.Append<Cors>();
+}
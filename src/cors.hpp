@@ -1,10 +1,32 @@
 #pragma once
 
+#include <string>
+
+#include <userver/components/component_list.hpp>
+#include <userver/components/loggable_component_base.hpp>
 #include <userver/server/handlers/http_handler_base.hpp>
+#include <userver/yaml_config/schema.hpp>
+
+// CORS header values are read from the static config once and reused for
+// every response
+class Cors final : public userver::components::LoggableComponentBase {
+public:
+    static constexpr std::string_view kName = "cors";
+
+    Cors(const userver::components::ComponentConfig& config,
+         const userver::components::ComponentContext& context);
+
+    void SetHeaders(const userver::server::http::HttpRequest& request) const;
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+private:
+    const std::string allow_origin_;
+    const std::string allow_methods_;
+    const std::string allow_headers_;
+};
+
+void AppendCors(userver::components::ComponentList& component_list);
 
-inline void SetCors(const userver::server::http::HttpRequest& request) {
-    auto& response = request.GetHttpResponse();
-    response.SetHeader("Access-Control-Allow-Origin", "http://158.160.37.44:8000");
-    response.SetHeader("Access-Control-Allow-Methods", "*");
-    response.SetHeader("Access-Control-Allow-Headers", "content-type");
-}
+template <>
+inline constexpr bool userver::components::kHasValidate<Cors> = true;
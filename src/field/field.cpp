@@ -11,6 +11,8 @@
 
 #include "field_stat.hpp"
 
+#include <game/shot.hpp>
+
 #include <cors.hpp>
 
 namespace battleship {
@@ -52,6 +54,7 @@ public:
 private:
     storages::redis::ClientPtr redis_client_;
     storages::redis::CommandControl redis_cc_;
+    const Cors& cors_;
 };
 
 FieldHandler::FieldHandler(const components::ComponentConfig& config,
@@ -59,16 +62,18 @@ FieldHandler::FieldHandler(const components::ComponentConfig& config,
     : server::handlers::HttpHandlerBase(config, context),
       redis_client_{
           context.FindComponent<components::Redis>("key-value-database")
-              .GetClient("main-kv")} { }
+              .GetClient("main-kv")},
+      cors_(context.FindComponent<Cors>()) { }
 
 std::string FieldHandler::HandleRequestThrow(const server::http::HttpRequest& request,
                                       server::request::RequestContext&) const {
-    SetCors(request);
+    cors_.SetHeaders(request);
     const auto player_id = request.GetArg("player_id");
     if (player_id.empty()) {
         return "Wrong player_id";
     }
-    if (!redis_client_->Hget("game_matcher", player_id, redis_cc_).Get().has_value()) {
+    const auto enemy_id = redis_client_->Hget("game_matcher", player_id, redis_cc_).Get();
+    if (!enemy_id.has_value()) {
         return "Wrong player_id";
     }
     
@@ -78,10 +83,14 @@ std::string FieldHandler::HandleRequestThrow(const server::http::HttpRequest& re
 
     const auto& body = request.RequestBody();
     formats::json::Value json = formats::json::FromString(body)["left_field"];
-    FieldHelper field(json["field"].As<Field>());
+    const auto parsed_field = json["field"].As<Field>();
+    FieldHelper field(parsed_field);
     FieldResultJsonBuilder field_json(field);
     if (field.IsValid()) {
-        redis_client_->Hset("game", player_id, body, redis_cc_);
+        // Only the validated field is stored, whatever else the body contains
+        redis_client_->Hset("game", player_id, std::string(FieldJsonWriter(parsed_field).View()), redis_cc_);
+        redis_client_->Hincrby("version", player_id, 1, redis_cc_);
+        redis_client_->Hincrby("version", enemy_id.value(), 1, redis_cc_);
     }
     return field_json.GetString();
 }
@@ -276,6 +285,41 @@ bool FieldHelper::IsKilled(const Field& field, size_t x, size_t y) {
     return true;
 }
 
+static bool IsShipPoint(FieldPoint point) {
+    return point == FieldPoint::Ship || point == FieldPoint::X_Ship;
+}
+
+size_t FieldHelper::CountAliveShips(const Field& field) {
+    std::array<std::array<bool, kFieldSize>, kFieldSize> visited{};
+    size_t alive_ships = 0;
+    for (size_t x = 0; x < kFieldSize; ++x) {
+        for (size_t y = 0; y < kFieldSize; ++y) {
+            if (visited[x][y] || !IsShipPoint(field[x][y])) {
+                continue;
+            }
+
+            // Ships are straight, so walk down or right from the first point
+            bool is_alive = false;
+            size_t current_x = x;
+            while (current_x < kFieldSize && IsShipPoint(field[current_x][y])) {
+                is_alive |= field[current_x][y] == FieldPoint::Ship;
+                visited[current_x][y] = true;
+                ++current_x;
+            }
+            size_t current_y = y + 1;
+            while (current_y < kFieldSize && IsShipPoint(field[x][current_y])) {
+                is_alive |= field[x][current_y] == FieldPoint::Ship;
+                visited[x][current_y] = true;
+                ++current_y;
+            }
+            if (is_alive) {
+                ++alive_ships;
+            }
+        }
+    }
+    return alive_ships;
+}
+
 void AppendField(userver::components::ComponentList& component_list) {
     component_list.Append<FieldHandler>();
 }
@@ -1,18 +1,25 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+
+#include <userver/formats/json_fwd.hpp>
+#include <userver/formats/parse/to.hpp>
+
 namespace battleship {
 
 enum class FieldPoint: size_t {
     Empty,
     Ship,
-    X_Ship
+    X_Ship,
+    Miss
 };
 
 static constexpr size_t kFieldSize = 10;
 using Field = std::array<std::array<FieldPoint, kFieldSize>, kFieldSize>;
 
-Field Parse(const formats::json::Value& json,
-            formats::parse::To<Field>);
+Field Parse(const userver::formats::json::Value& json,
+            userver::formats::parse::To<Field>);
 
 struct FieldShips {
     size_t ship_1 = 0;
@@ -29,6 +36,7 @@ public:
 
     static bool IsAllShipsDead(const Field& field);
     static bool IsKilled(const Field& field, size_t x, size_t y);
+    static size_t CountAliveShips(const Field& field);
 
 private:
     bool CountShipsAndCheckValid();
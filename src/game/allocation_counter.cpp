@@ -0,0 +1,122 @@
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// Every replaceable allocation function is counted, the deallocation ones
+// only pair them with std::free. Under ASan the memory still comes from the
+// sanitizer's malloc/free, only its new/delete mismatch checks are lost.
+
+namespace battleship {
+
+namespace {
+
+thread_local size_t allocations_count = 0;
+
+void* Allocate(std::size_t size) noexcept {
+    ++allocations_count;
+    return std::malloc(size ? size : 1);
+}
+
+void* Allocate(std::size_t size, std::align_val_t align) noexcept {
+    ++allocations_count;
+    // aligned_alloc wants the size to be a non-zero multiple of the alignment
+    const auto alignment = static_cast<std::size_t>(align);
+    const auto rounded_size = std::max<std::size_t>((size + alignment - 1) / alignment, 1) * alignment;
+    return std::aligned_alloc(alignment, rounded_size);
+}
+
+}
+
+size_t GetAllocationsCount() {
+    return allocations_count;
+}
+
+}
+
+void* operator new(std::size_t size) {
+    if (void* ptr = battleship::Allocate(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return battleship::Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return battleship::Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* ptr = battleship::Allocate(size, align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return operator new(size, align);
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return battleship::Allocate(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return battleship::Allocate(size, align);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocations made by the current thread. Counted by the global
+// operator new replacements from allocation_counter.cpp, link it only into
+// test binaries.
+
+namespace battleship {
+
+size_t GetAllocationsCount();
+
+}
@@ -10,13 +10,18 @@
 #include <userver/utils/async.hpp>
 #include <userver/engine/sleep.hpp>
 #include <userver/formats/serialize/common_containers.hpp>
+#include <userver/http/common_headers.hpp>
 
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <optional>
 #include <string>
 
 #include <field/field_stat.hpp>
+#include <game/ruleset.hpp>
+#include <game/shot.hpp>
+#include <rate_limiter/rate_limiter.hpp>
 #include <cors.hpp>
+#include <timestamp.hpp>
 
 namespace battleship {
 
@@ -37,6 +42,8 @@ public:
 private:
     storages::redis::ClientPtr redis_client_;
     storages::redis::CommandControl redis_cc_;
+    RateLimiter& rate_limiter_;
+    const Cors& cors_;
 };
 
 GameHandler::GameHandler(const components::ComponentConfig& config,
@@ -44,7 +51,9 @@ GameHandler::GameHandler(const components::ComponentConfig& config,
     : server::handlers::HttpHandlerBase(config, context),
       redis_client_{
           context.FindComponent<components::Redis>("key-value-database")
-            .GetClient("main-kv")} { }
+            .GetClient("main-kv")},
+      rate_limiter_(context.FindComponent<RateLimiter>()),
+      cors_(context.FindComponent<Cors>()) { }
 
 template <class Value>
 Value Serialize(const Field& field, formats::serialize::To<Value>) {
@@ -61,55 +70,88 @@ Value Serialize(const Field& field, formats::serialize::To<Value>) {
     return builder.ExtractValue();
 }
 
+// Stored fields are read without json DOM, the DOM is left for fields in
+// an unexpected format
+static Field LoadField(const std::string& json) {
+    auto field = ParseFieldJson(json);
+    if (field.has_value()) {
+        return *field;
+    }
+    return formats::json::FromString(json)["left_field"]["field"].As<Field>();
+}
+
 std::string GameHandler::HandleRequestThrow(const userver::server::http::HttpRequest& request,
                                             userver::server::request::RequestContext&) const {
-    SetCors(request);
+    cors_.SetHeaders(request);
     const auto& player_id = request.GetArg("player_id");
     const auto& x_str = request.GetArg("x");
     const auto& y_str = request.GetArg("y");
-    
-    if (player_id.empty() || x_str.empty() || y_str.empty()) {
+    const auto& shots_str = request.GetArg("shots");
+    const bool is_salvo = !shots_str.empty();
+
+    if (player_id.empty() || (!is_salvo && (x_str.empty() || y_str.empty()))) {
         return "Wrong params";
     }
-    redis_client_->Hset("time", player_id, std::to_string(std::time(nullptr)), redis_cc_);
+    if (!rate_limiter_.Allow(kName, player_id)) {
+        request.SetResponseStatus(server::http::HttpStatus::kTooManyRequests);
+        return "Too many requests";
+    }
+    redis_client_->Hset("time", player_id, CurrentTimestamp(), redis_cc_);
+    auto mode_request = redis_client_->Hget("mode", player_id, redis_cc_);
 
     const auto my_field_str = redis_client_->Hget("game", player_id, redis_cc_).Get().value_or("");
     if (my_field_str.empty()) {
         return "your field is broken";
     }
 
-    formats::json::Value my_field_json = formats::json::FromString(my_field_str);
-    auto my_field = my_field_json["left_field"]["field"].As<Field>();
+    const auto my_field = LoadField(my_field_str);
     if (FieldHelper::IsAllShipsDead(my_field)) {
         return "You lose";
     }
 
-    const auto str_to_size_t = [](const std::string& str) {
-        std::stringstream iss(str);
-        size_t result = 0;
-        iss >> result;
-        return result;
-    };
+    const auto ruleset = ParseRuleset(mode_request.Get().value_or("")).value_or(Ruleset::Classic);
+    if ((ruleset == Ruleset::Salvo) != is_salvo) {
+        return "Wrong game mode";
+    }
 
-    const auto x = str_to_size_t(x_str);
-    const auto y = str_to_size_t(y_str);
-    if (x >= kFieldSize || y >= kFieldSize) {
-        return "wrong coords";
+    Salvo salvo;
+    if (is_salvo) {
+        const auto shots_count = std::count(shots_str.begin(), shots_str.end(), ',') + 1;
+        if (static_cast<size_t>(shots_count) > FieldHelper::CountAliveShips(my_field)) {
+            return "wrong shots count";
+        }
+        auto parsed_salvo = ParseShots(shots_str);
+        if (!parsed_salvo.has_value()) {
+            return "Wrong params";
+        }
+        salvo = *parsed_salvo;
+    } else {
+        const auto x = ParseCoord(x_str);
+        const auto y = ParseCoord(y_str);
+        if (!x.has_value() || !y.has_value()) {
+            return "wrong coords";
+        }
+        salvo.shots[0] = {*x, *y};
+        salvo.size = 1;
+    }
+    for (size_t i = 0; i < salvo.size; ++i) {
+        if (salvo.shots[i].x >= kFieldSize || salvo.shots[i].y >= kFieldSize) {
+            return "wrong coords";
+        }
     }
 
     const auto enemy_id = redis_client_->Hget("game_matcher", player_id, redis_cc_).Get().value_or("");
     if (enemy_id.empty()) {
         return "player_id is broken";
     }
-    redis_client_->Hset("time", enemy_id, std::to_string(std::time(nullptr)), redis_cc_);
+    redis_client_->Hset("time", enemy_id, CurrentTimestamp(), redis_cc_);
 
     const auto field_str = redis_client_->Hget("game", enemy_id, redis_cc_).Get().value_or("");
     if (field_str.empty()) {
         return "enemy field is broken";
     }
 
-    formats::json::Value field_json = formats::json::FromString(field_str);
-    auto field = field_json["left_field"]["field"].As<Field>();
+    auto field = LoadField(field_str);
     if (FieldHelper::IsAllShipsDead(field)) {
         return "You win";
     }
@@ -119,22 +161,119 @@ std::string GameHandler::HandleRequestThrow(const userver::server::http::HttpReq
     }
     redis_client_->Hset("turn", player_id, "0", redis_cc_);
     redis_client_->Hset("turn", enemy_id, "1", redis_cc_);
-    if (field[x][y] == FieldPoint::Ship) {
-        field[x][y] = FieldPoint::X_Ship;
-        formats::json::ValueBuilder builder;
-        builder["left_field"] = field;
-
-        redis_client_->Hset("game", enemy_id, ToString(builder.ExtractValue()), redis_cc_);
-        if (FieldHelper::IsKilled(field, x, y)) {
-            return "Kill";
+
+    // All shots are resolved against the loaded field, which is stored once.
+    // Responses are written into fixed buffers, heap allocations left here are
+    // forced by the userver API: redis commands take std::string arguments
+    // (hence the copy of the field for HSET) and return std::optional<std::string>
+    // replies, and the response body is returned as std::string.
+    const auto old_field = field;
+    const auto result = ResolveSalvo(field, salvo);
+    if (field != old_field) {
+        redis_client_->Hset("game", enemy_id, std::string(FieldJsonWriter(field).View()), redis_cc_);
+    }
+    redis_client_->Hincrby("version", player_id, 1, redis_cc_);
+    redis_client_->Hincrby("version", enemy_id, 1, redis_cc_);
+
+    if (!is_salvo) {
+        return std::string(ToString(result));
+    }
+    return std::string(SalvoJsonWriter(salvo, result).View());
+}
+
+class GameStateHandler final : public userver::server::handlers::HttpHandlerBase {
+public:
+    static constexpr std::string_view kName = "handler-gamestate";
+
+    using HttpHandlerBase::HttpHandlerBase;
+
+    GameStateHandler(const components::ComponentConfig& config,
+                     const components::ComponentContext& context);
+
+    std::string HandleRequestThrow(
+        const userver::server::http::HttpRequest& request,
+        userver::server::request::RequestContext&) const override;
+
+private:
+    storages::redis::ClientPtr redis_client_;
+    storages::redis::CommandControl redis_cc_;
+    const Cors& cors_;
+};
+
+GameStateHandler::GameStateHandler(const components::ComponentConfig& config,
+                                   const components::ComponentContext& context)
+    : server::handlers::HttpHandlerBase(config, context),
+      redis_client_{
+          context.FindComponent<components::Redis>("key-value-database")
+            .GetClient("main-kv")},
+      cors_(context.FindComponent<Cors>()) { }
+
+// Opponent's ships are hidden until they are hit
+static Field ApplyFogOfWar(Field field) {
+    for (auto& line : field) {
+        for (auto& point : line) {
+            if (point == FieldPoint::Ship) {
+                point = FieldPoint::Empty;
+            }
+        }
+    }
+    return field;
+}
+
+std::string GameStateHandler::HandleRequestThrow(const userver::server::http::HttpRequest& request,
+                                                 userver::server::request::RequestContext&) const {
+    cors_.SetHeaders(request);
+    const auto& player_id = request.GetArg("player_id");
+    if (player_id.empty()) {
+        return "Wrong player_id";
+    }
+
+    // Not rate limited: polls are meant to be frequent and must not eat the
+    // player's /trykill budget, a 304 costs a single HGET and no writes.
+
+    // Version is set when the pair is matched and bumped on every change of
+    // the game, so a matching ETag is answered before any field is loaded.
+    // Players without a version are not in a game and get no ETag.
+    const auto version = redis_client_->Hget("version", player_id, redis_cc_).Get();
+    if (version.has_value()) {
+        const auto etag = '"' + *version + '"';
+        auto& response = request.GetHttpResponse();
+        response.SetHeader(http::headers::kETag, etag);
+        if (request.GetHeader(http::headers::kIfNoneMatch) == etag) {
+            request.SetResponseStatus(server::http::HttpStatus::kNotModified);
+            return "";
         }
-        return "Damage";
     }
-    return "Miss";
+
+    const auto enemy_id = redis_client_->Hget("game_matcher", player_id, redis_cc_).Get().value_or("");
+    if (enemy_id.empty()) {
+        return "player_id is broken";
+    }
+    auto my_field_request = redis_client_->Hget("game", player_id, redis_cc_);
+    auto field_request = redis_client_->Hget("game", enemy_id, redis_cc_);
+    auto turn_request = redis_client_->Hget("turn", player_id, redis_cc_);
+    auto mode_request = redis_client_->Hget("mode", player_id, redis_cc_);
+
+    formats::json::ValueBuilder builder;
+    builder["version"] = std::stoll(version.value_or("0"));
+    builder["mode"] = std::string(ToString(
+        ParseRuleset(mode_request.Get().value_or("")).value_or(Ruleset::Classic)));
+    builder["your_turn"] = turn_request.Get().value_or("0") == "1";
+
+    const auto my_field_str = my_field_request.Get();
+    if (my_field_str.has_value()) {
+        builder["my_field"] = LoadField(*my_field_str);
+    }
+    const auto field_str = field_request.Get();
+    if (field_str.has_value()) {
+        builder["enemy_field"] = ApplyFogOfWar(LoadField(*field_str));
+    }
+    return ToString(builder.ExtractValue());
 }
 
 void AppendGame(userver::components::ComponentList& component_list) {
-    component_list.Append<GameHandler>();
+    component_list.Append<GameHandler>()
+                  .Append<GameStateHandler>();
 }
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string_view>
+
+namespace battleship {
+
+enum class Ruleset {
+    Classic,
+    // One shot per surviving ship each turn
+    Salvo
+};
+
+static constexpr std::array kRulesets = {Ruleset::Classic, Ruleset::Salvo};
+
+inline std::string_view ToString(Ruleset ruleset) {
+    switch (ruleset) {
+        case Ruleset::Classic:
+            return "classic";
+        case Ruleset::Salvo:
+            return "salvo";
+    }
+    return "classic";
+}
+
+inline std::optional<Ruleset> ParseRuleset(std::string_view str) {
+    for (const auto ruleset : kRulesets) {
+        if (ToString(ruleset) == str) {
+            return ruleset;
+        }
+    }
+    return std::nullopt;
+}
+
+}
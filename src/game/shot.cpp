@@ -0,0 +1,279 @@
+#include "shot.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace battleship {
+
+std::string_view ToString(ShotResult result) {
+    switch (result) {
+        case ShotResult::Miss:
+            return "Miss";
+        case ShotResult::Damage:
+            return "Damage";
+        case ShotResult::Kill:
+            return "Kill";
+    }
+    return "Miss";
+}
+
+ShotResult Fire(Field& field, size_t x, size_t y) {
+    if (field[x][y] == FieldPoint::Empty) {
+        field[x][y] = FieldPoint::Miss;
+    }
+    if (field[x][y] != FieldPoint::Ship) {
+        return ShotResult::Miss;
+    }
+    field[x][y] = FieldPoint::X_Ship;
+    if (FieldHelper::IsKilled(field, x, y)) {
+        return ShotResult::Kill;
+    }
+    return ShotResult::Damage;
+}
+
+ShotResult ResolveSalvo(Field& field, Salvo& salvo) {
+    auto result = ShotResult::Miss;
+    for (size_t i = 0; i < salvo.size; ++i) {
+        auto& shot = salvo.shots[i];
+        shot.result = Fire(field, shot.x, shot.y);
+        result = std::max(result, shot.result);
+    }
+    return result;
+}
+
+std::optional<size_t> ParseCoord(std::string_view str) {
+    size_t result = 0;
+    const auto end = str.data() + str.size();
+    const auto [ptr, ec] = std::from_chars(str.data(), end, result);
+    if (ec != std::errc() || ptr != end) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<Salvo> ParseShots(std::string_view str) {
+    Salvo salvo;
+    while (!str.empty()) {
+        const auto shot_end = std::min(str.find(','), str.size());
+        const auto shot_str = str.substr(0, shot_end);
+        str.remove_prefix(std::min(shot_end + 1, str.size()));
+
+        const auto delimiter = shot_str.find(':');
+        if (delimiter == std::string_view::npos || salvo.size == kMaxSalvoShots) {
+            return std::nullopt;
+        }
+        const auto x = ParseCoord(shot_str.substr(0, delimiter));
+        const auto y = ParseCoord(shot_str.substr(delimiter + 1));
+        if (!x.has_value() || !y.has_value()) {
+            return std::nullopt;
+        }
+        salvo.shots[salvo.size++] = {*x, *y};
+    }
+    return salvo;
+}
+
+namespace {
+
+class JsonScanner {
+public:
+    explicit JsonScanner(std::string_view json)
+        : json_(json) { }
+
+    // Moves to the value of a direct member of the object whose '{' was just
+    // consumed, values of other members are skipped as a whole
+    bool FindMember(std::string_view key) {
+        if (Consume('}')) {
+            return false;
+        }
+        while (true) {
+            const auto member = String();
+            if (!member.has_value() || !Consume(':')) {
+                return false;
+            }
+            if (*member == key) {
+                return true;
+            }
+            if (!SkipValue() || !Consume(',')) {
+                return false;
+            }
+        }
+    }
+
+    bool Consume(char c) {
+        SkipSpaces();
+        if (json_.empty() || json_.front() != c) {
+            return false;
+        }
+        json_.remove_prefix(1);
+        return true;
+    }
+
+    std::optional<size_t> Number() {
+        SkipSpaces();
+        size_t result = 0;
+        const auto [ptr, ec] = std::from_chars(json_.data(), json_.data() + json_.size(), result);
+        if (ec != std::errc()) {
+            return std::nullopt;
+        }
+        json_.remove_prefix(ptr - json_.data());
+        return result;
+    }
+
+private:
+    // Raw string contents, escape sequences are kept as is
+    std::optional<std::string_view> String() {
+        if (!Consume('"')) {
+            return std::nullopt;
+        }
+        for (size_t i = 0; i < json_.size(); ++i) {
+            if (json_[i] == '\\') {
+                ++i;
+            } else if (json_[i] == '"') {
+                const auto result = json_.substr(0, i);
+                json_.remove_prefix(i + 1);
+                return result;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool SkipValue() {
+        SkipSpaces();
+        if (json_.empty()) {
+            return false;
+        }
+        if (json_.front() == '"') {
+            return String().has_value();
+        }
+        if (json_.front() != '{' && json_.front() != '[') {
+            const auto end = json_.find_first_of(",}] \n\r\t");
+            json_.remove_prefix(std::min(end, json_.size()));
+            return true;
+        }
+
+        size_t depth = 0;
+        while (!json_.empty()) {
+            const char c = json_.front();
+            if (c == '"') {
+                if (!String().has_value()) {
+                    return false;
+                }
+                continue;
+            }
+            json_.remove_prefix(1);
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SkipSpaces() {
+        while (!json_.empty() && (json_.front() == ' ' || json_.front() == '\n' ||
+                                  json_.front() == '\r' || json_.front() == '\t')) {
+            json_.remove_prefix(1);
+        }
+    }
+
+private:
+    std::string_view json_;
+};
+
+}
+
+std::optional<Field> ParseFieldJson(std::string_view json) {
+    JsonScanner scanner(json);
+    if (!scanner.Consume('{') || !scanner.FindMember("left_field") ||
+        !scanner.Consume('{') || !scanner.FindMember("field")) {
+        return std::nullopt;
+    }
+
+    Field field;
+    if (!scanner.Consume('[')) {
+        return std::nullopt;
+    }
+    for (size_t x = 0; x < kFieldSize; ++x) {
+        if (!scanner.Consume('[')) {
+            return std::nullopt;
+        }
+        for (size_t y = 0; y < kFieldSize; ++y) {
+            const auto point = scanner.Number();
+            if (!point.has_value() || *point > static_cast<size_t>(FieldPoint::Miss)) {
+                return std::nullopt;
+            }
+            field[x][y] = static_cast<FieldPoint>(*point);
+            if (!scanner.Consume(y + 1 < kFieldSize ? ',' : ']')) {
+                return std::nullopt;
+            }
+        }
+        if (!scanner.Consume(x + 1 < kFieldSize ? ',' : ']')) {
+            return std::nullopt;
+        }
+    }
+    return field;
+}
+
+FieldJsonWriter::FieldJsonWriter(const Field& field) {
+    auto it = std::copy(kPrefix.begin(), kPrefix.end(), buffer_.begin());
+    for (size_t x = 0; x < kFieldSize; ++x) {
+        if (x > 0) {
+            *it++ = ',';
+        }
+        *it++ = '[';
+        for (size_t y = 0; y < kFieldSize; ++y) {
+            if (y > 0) {
+                *it++ = ',';
+            }
+            *it++ = static_cast<char>('0' + static_cast<size_t>(field[x][y]));
+        }
+        *it++ = ']';
+    }
+    std::copy(kSuffix.begin(), kSuffix.end(), it);
+}
+
+std::string_view FieldJsonWriter::View() const {
+    return {buffer_.data(), buffer_.size()};
+}
+
+namespace {
+
+char* Append(char* it, std::string_view str) {
+    return std::copy(str.begin(), str.end(), it);
+}
+
+char* Append(char* it, char* end, size_t number) {
+    return std::to_chars(it, end, number).ptr;
+}
+
+}
+
+SalvoJsonWriter::SalvoJsonWriter(const Salvo& salvo, ShotResult result) {
+    char* const begin = buffer_.data();
+    char* const end = begin + buffer_.size();
+    auto it = Append(begin, R"({"shots":[)");
+    for (size_t i = 0; i < salvo.size; ++i) {
+        const auto& shot = salvo.shots[i];
+        if (i > 0) {
+            *it++ = ',';
+        }
+        it = Append(it, R"({"x":)");
+        it = Append(it, end, shot.x);
+        it = Append(it, R"(,"y":)");
+        it = Append(it, end, shot.y);
+        it = Append(it, R"(,"result":")");
+        it = Append(it, ToString(shot.result));
+        it = Append(it, R"("})");
+    }
+    it = Append(it, R"(],"result":")");
+    it = Append(it, ToString(result));
+    it = Append(it, R"("})");
+    size_ = it - begin;
+}
+
+std::string_view SalvoJsonWriter::View() const {
+    return {buffer_.data(), size_};
+}
+
+}
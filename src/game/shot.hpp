@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+#include <field/field_stat.hpp>
+
+// Shot resolution helpers used by /trykill. Nothing here allocates, so the
+// only heap work left on the shot path is on the redis and http boundaries.
+
+namespace battleship {
+
+enum class ShotResult {
+    Miss,
+    Damage,
+    Kill
+};
+
+std::string_view ToString(ShotResult result);
+
+struct Shot {
+    size_t x = 0;
+    size_t y = 0;
+    ShotResult result = ShotResult::Miss;
+};
+
+// One shot per ship is the most a salvo can have
+static constexpr size_t kMaxSalvoShots = 10;
+
+struct Salvo {
+    std::array<Shot, kMaxSalvoShots> shots;
+    size_t size = 0;
+};
+
+ShotResult Fire(Field& field, size_t x, size_t y);
+
+// Resolves all shots against the field in one pass, stores per-shot results
+// in the salvo and returns the strongest of them
+ShotResult ResolveSalvo(Field& field, Salvo& salvo);
+
+std::optional<size_t> ParseCoord(std::string_view str);
+
+// Parses salvo shots in "x:y,x:y,..." format
+std::optional<Salvo> ParseShots(std::string_view str);
+
+// Reads {"left_field": {"field": [[...], ...]}} without building a json DOM.
+// Only direct members are matched, "field" keys nested in other values are
+// skipped. Returns nullopt on anything unusual, callers fall back to
+// formats::json then.
+std::optional<Field> ParseFieldJson(std::string_view json);
+
+// Writes a field in the format ParseFieldJson reads into a fixed size buffer
+class FieldJsonWriter {
+public:
+    explicit FieldJsonWriter(const Field& field);
+    std::string_view View() const;
+
+private:
+    static constexpr std::string_view kPrefix = R"({"left_field":{"field":[)";
+    static constexpr std::string_view kSuffix = "]}}";
+    static constexpr size_t kRowSize = 2 * kFieldSize + 1;
+
+    std::array<char, kPrefix.size() + kFieldSize * (kRowSize + 1) - 1 + kSuffix.size()> buffer_;
+};
+
+// Writes the /trykill salvo response
+// {"shots":[{"x":0,"y":0,"result":"Miss"},...],"result":"Miss"} into a fixed size buffer
+class SalvoJsonWriter {
+public:
+    SalvoJsonWriter(const Salvo& salvo, ShotResult result);
+    std::string_view View() const;
+
+private:
+    static constexpr size_t kMaxNumberSize = std::numeric_limits<size_t>::digits10 + 1;
+    static constexpr size_t kMaxResultSize = std::string_view("Damage").size();
+    static constexpr size_t kMaxShotSize =
+        std::string_view(R"({"x":,"y":,"result":""},)").size() + 2 * kMaxNumberSize + kMaxResultSize;
+    static constexpr size_t kMaxSize = std::string_view(R"({"shots":[],"result":""})").size() +
+                                       kMaxSalvoShots * kMaxShotSize + kMaxResultSize;
+
+    std::array<char, kMaxSize> buffer_;
+    size_t size_ = 0;
+};
+
+}
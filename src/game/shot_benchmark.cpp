@@ -0,0 +1,42 @@
+#include "shot.hpp"
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <game/allocation_counter.hpp>
+#include <timestamp.hpp>
+
+namespace battleship {
+
+// Everything /trykill does for a shot and a salvo apart from redis and http
+void ShotPathBenchmark(benchmark::State& state) {
+    Field empty_field{};
+    empty_field[0][0] = FieldPoint::Ship;
+    const std::string field_str(FieldJsonWriter(empty_field).View());
+    const std::string x_str = "5";
+    const std::string y_str = "5";
+    const std::string shots_str = "0:0,5:5,9:9";
+
+    const auto allocations_before = GetAllocationsCount();
+    for (auto _ : state) {
+        const auto x = ParseCoord(x_str);
+        const auto y = ParseCoord(y_str);
+        auto field = ParseFieldJson(field_str);
+        benchmark::DoNotOptimize(ToString(Fire(*field, *x, *y)).data());
+
+        auto salvo = ParseShots(shots_str);
+        const SalvoJsonWriter salvo_writer(*salvo, ResolveSalvo(*field, *salvo));
+        benchmark::DoNotOptimize(salvo_writer.View().data());
+
+        const FieldJsonWriter field_writer(*field);
+        benchmark::DoNotOptimize(field_writer.View().data());
+        benchmark::DoNotOptimize(CurrentTimestamp().data());
+    }
+    state.counters["allocations_per_shot"] = benchmark::Counter(
+        static_cast<double>(GetAllocationsCount() - allocations_before),
+        benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(ShotPathBenchmark);
+
+}
@@ -0,0 +1,160 @@
+#include "shot.hpp"
+
+#include <new>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <game/allocation_counter.hpp>
+#include <timestamp.hpp>
+
+namespace battleship {
+
+namespace {
+
+const std::string kFieldBody = R"({"left_field": {
+    "field": [
+        [0, 0, 0, 0, 0, 0, 0, 1, 1, 1],
+        [1, 0, 1, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [1, 1, 0, 0, 0, 0, 0, 1, 0, 1],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 1, 0, 0, 1, 0, 0, 1, 0, 1]]}})";
+
+}
+
+TEST(Shot, ParseCoord) {
+    EXPECT_EQ(ParseCoord("7"), 7u);
+    EXPECT_EQ(ParseCoord(""), std::nullopt);
+    EXPECT_EQ(ParseCoord("1a"), std::nullopt);
+    EXPECT_EQ(ParseCoord("-1"), std::nullopt);
+}
+
+TEST(Shot, ParseShots) {
+    const auto salvo = ParseShots("0:0,1:5,9:9");
+    ASSERT_TRUE(salvo.has_value());
+    ASSERT_EQ(salvo->size, 3u);
+    EXPECT_EQ(salvo->shots[1].x, 1u);
+    EXPECT_EQ(salvo->shots[1].y, 5u);
+
+    EXPECT_FALSE(ParseShots("0:0,,1:1").has_value());
+    EXPECT_FALSE(ParseShots("0-0").has_value());
+    EXPECT_FALSE(ParseShots("0:0,0:0,0:0,0:0,0:0,0:0,0:0,0:0,0:0,0:0,0:0").has_value());
+}
+
+TEST(Shot, FieldJsonRoundTrip) {
+    const auto field = ParseFieldJson(kFieldBody);
+    ASSERT_TRUE(field.has_value());
+    EXPECT_EQ((*field)[0][7], FieldPoint::Ship);
+    EXPECT_EQ((*field)[4][0], FieldPoint::Empty);
+
+    const FieldJsonWriter writer(*field);
+    EXPECT_EQ(ParseFieldJson(writer.View()), field);
+
+    EXPECT_FALSE(ParseFieldJson(R"({"left_field": {"field": [[0, 1]]}})").has_value());
+    EXPECT_FALSE(ParseFieldJson(R"({"left_field": "field"})").has_value());
+    EXPECT_FALSE(ParseFieldJson(R"({"field": [[0, 1]]})").has_value());
+}
+
+TEST(Shot, FieldJsonNestedDecoy) {
+    const std::string decoy_row = "[1, 1, 1, 1, 1, 1, 1, 1, 1, 1]";
+    std::string decoy = "[" + decoy_row;
+    for (size_t i = 1; i < kFieldSize; ++i) {
+        decoy += ", " + decoy_row;
+    }
+    decoy += "]";
+    const std::string valid_field(FieldJsonWriter(*ParseFieldJson(kFieldBody)).View());
+    const auto valid_begin = valid_field.find("[[");
+    const auto valid = valid_field.substr(valid_begin, valid_field.rfind("]]") + 2 - valid_begin);
+
+    const auto body = R"({"decoy": {"left_field": {"field": )" + decoy + R"(}}, "left_field": {)" +
+                      R"("name": "a \"field\"", "decoy": {"field": )" + decoy + R"(}, "field": )" + valid + "}}";
+    const auto field = ParseFieldJson(body);
+    ASSERT_TRUE(field.has_value());
+    EXPECT_EQ(field, ParseFieldJson(kFieldBody));
+}
+
+TEST(Shot, Fire) {
+    auto field = *ParseFieldJson(kFieldBody);
+    EXPECT_EQ(Fire(field, 0, 0), ShotResult::Miss);
+    EXPECT_EQ(field[0][0], FieldPoint::Miss);
+    EXPECT_EQ(Fire(field, 1, 0), ShotResult::Kill);
+    EXPECT_EQ(Fire(field, 0, 7), ShotResult::Damage);
+    EXPECT_EQ(Fire(field, 0, 8), ShotResult::Damage);
+    EXPECT_EQ(Fire(field, 0, 9), ShotResult::Kill);
+    EXPECT_EQ(Fire(field, 0, 9), ShotResult::Miss);
+}
+
+TEST(Shot, SalvoJson) {
+    auto field = *ParseFieldJson(kFieldBody);
+    auto salvo = *ParseShots("0:0,1:0,0:7");
+    const auto result = ResolveSalvo(field, salvo);
+    EXPECT_EQ(result, ShotResult::Kill);
+    EXPECT_EQ(salvo.shots[2].result, ShotResult::Damage);
+
+    EXPECT_EQ(SalvoJsonWriter(salvo, result).View(),
+              R"({"shots":[{"x":0,"y":0,"result":"Miss"},{"x":1,"y":0,"result":"Kill"},)"
+              R"({"x":0,"y":7,"result":"Damage"}],"result":"Kill"})");
+    EXPECT_EQ(SalvoJsonWriter(Salvo{}, ShotResult::Miss).View(), R"({"shots":[],"result":"Miss"})");
+}
+
+TEST(Shot, AllocationsCounted) {
+    struct alignas(64) Aligned {
+        char data[3];
+    };
+    // Volatile store keeps the compiler from eliding new/delete pairs
+    static void* volatile sink = nullptr;
+    const auto allocations_before = GetAllocationsCount();
+
+    delete static_cast<int*>(sink = new int);
+    delete[] static_cast<int*>(sink = new int[4]);
+    delete static_cast<int*>(sink = new (std::nothrow) int);
+    delete[] static_cast<int*>(sink = new (std::nothrow) int[4]);
+    delete static_cast<Aligned*>(sink = new Aligned);
+    delete[] static_cast<Aligned*>(sink = new Aligned[4]);
+    delete static_cast<Aligned*>(sink = new (std::nothrow) Aligned);
+    delete[] static_cast<Aligned*>(sink = new (std::nothrow) Aligned[4]);
+
+    EXPECT_EQ(GetAllocationsCount(), allocations_before + 8);
+}
+
+// Everything /trykill does apart from redis and http, both for a classic
+// shot and for a salvo
+TEST(Shot, NoAllocations) {
+    const std::string field_str(FieldJsonWriter(*ParseFieldJson(kFieldBody)).View());
+    const std::string x_str = "0";
+    const std::string y_str = "8";
+    const std::string shots_str = "0:7,0:9,1:0";
+    CurrentTimestamp();
+
+    const auto allocations_before = GetAllocationsCount();
+
+    const auto x = ParseCoord(x_str);
+    const auto y = ParseCoord(y_str);
+    auto field = ParseFieldJson(field_str);
+    Salvo shot;
+    shot.shots[0] = {*x, *y};
+    shot.size = 1;
+    const auto result = ResolveSalvo(*field, shot);
+    const auto result_str = ToString(result);
+
+    auto salvo = ParseShots(shots_str);
+    const auto salvo_result = ResolveSalvo(*field, *salvo);
+    const SalvoJsonWriter salvo_writer(*salvo, salvo_result);
+
+    const FieldJsonWriter field_writer(*field);
+    const auto& timestamp = CurrentTimestamp();
+
+    EXPECT_EQ(GetAllocationsCount(), allocations_before);
+    EXPECT_EQ(result_str, "Damage");
+    EXPECT_EQ(salvo_result, ShotResult::Kill);
+    EXPECT_FALSE(salvo_writer.View().empty());
+    EXPECT_FALSE(field_writer.View().empty());
+    EXPECT_FALSE(timestamp.empty());
+}
+
+}
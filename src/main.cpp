@@ -1,27 +1,37 @@
 #include <userver/components/minimal_server_component_list.hpp>
 #include <userver/server/handlers/ping.hpp>
 #include <userver/utils/daemon_run.hpp>
+#include <userver/clients/config/component.hpp>
 #include <userver/clients/http/component.hpp>
+#include <userver/dynamic_config/updater/component.hpp>
+#include <userver/server/handlers/server_monitor.hpp>
 #include <userver/testsuite/testsuite_support.hpp>
 #include <userver/server/handlers/tests_control.hpp>
 #include <userver/storages/redis/component.hpp>
 #include <userver/storages/secdist/component.hpp>
 
 
+#include "cors.hpp"
 #include "options.hpp"
 #include "registration/registration.hpp"
 #include "field/field.hpp"
 #include "game/game.hpp"
+#include "rate_limiter/rate_limiter.hpp"
 
 int main(int argc, char *argv[]) {
     auto component_list = userver::components::MinimalServerComponentList()
                               .Append<userver::server::handlers::Ping>()
+                              .Append<userver::server::handlers::ServerMonitor>()
                               .Append<userver::components::HttpClient>()
+                              .Append<userver::components::DynamicConfigClient>()
+                              .Append<userver::components::DynamicConfigClientUpdater>()
                               .Append<userver::components::Secdist>()
                               .Append<userver::components::Redis>("key-value-database")
                               .Append<userver::server::handlers::TestsControl>()
                               .Append<userver::components::TestsuiteSupport>();
   
+    AppendCors(component_list);
+    battleship::AppendRateLimiter(component_list);
     battleship::AppendRegistrator(component_list);
     battleship::AppendField(component_list);
     battleship::AppendGame(component_list);
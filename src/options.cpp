@@ -8,6 +8,7 @@
 #include <userver/utils/async.hpp>
 #include <userver/engine/sleep.hpp>
 #include <userver/formats/json.hpp>
+#include <userver/components/component_context.hpp>
 
 #include <cors.hpp>
 
@@ -17,13 +18,19 @@ class ImplicitOptions final : public server::handlers::HttpHandlerBase {
 public:
     static constexpr std::string_view kName = "handler-implicit-options";
 
-    using HttpHandlerBase::HttpHandlerBase;
+    ImplicitOptions(const components::ComponentConfig& config,
+                    const components::ComponentContext& context)
+        : HttpHandlerBase(config, context),
+          cors_(context.FindComponent<Cors>()) { }
 
     std::string HandleRequestThrow(const server::http::HttpRequest& request,
                                    server::request::RequestContext&) const override {
-        SetCors(request);
+        cors_.SetHeaders(request);
         return "";
     }
+
+private:
+    const Cors& cors_;
 };
 
 void AppendOptions(userver::components::ComponentList &component_list) {
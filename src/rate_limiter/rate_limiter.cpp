@@ -0,0 +1,195 @@
+#include "rate_limiter.hpp"
+
+#include <userver/utest/using_namespace_userver.hpp>
+#include <userver/cache/lru_map.hpp>
+#include <userver/components/component_config.hpp>
+#include <userver/components/component_context.hpp>
+#include <userver/components/statistics_storage.hpp>
+#include <userver/dynamic_config/snapshot.hpp>
+#include <userver/dynamic_config/storage/component.hpp>
+#include <userver/dynamic_config/value.hpp>
+#include <userver/engine/mutex.hpp>
+#include <userver/formats/json.hpp>
+#include <userver/formats/parse/common_containers.hpp>
+#include <userver/utils/statistics/metric_tag.hpp>
+#include <userver/utils/statistics/metrics_storage.hpp>
+#include <userver/utils/statistics/writer.hpp>
+#include <userver/yaml_config/merge_schemas.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace battleship {
+
+struct RateLimitConfig {
+    bool enabled = true;
+    std::int64_t bucket_size = 0;
+    double refill_per_second = 0;
+
+    // Derived GCRA parameters: time to refill one token and the whole bucket
+    std::int64_t interval_ns = 0;
+    std::int64_t tolerance_ns = 0;
+};
+
+// Tolerance is added to steady_clock timestamps, half of the range leaves
+// room for about 146 years of uptime
+static constexpr auto kMaxToleranceNs = std::numeric_limits<std::int64_t>::max() / 2;
+
+RateLimitConfig Parse(const formats::json::Value& json,
+                      formats::parse::To<RateLimitConfig>) {
+    RateLimitConfig config;
+    config.enabled = json["enabled"].As<bool>(true);
+    config.bucket_size = json["bucket-size"].As<std::int64_t>();
+    config.refill_per_second = json["refill-per-second"].As<double>();
+    if (config.bucket_size < 1 || !(config.refill_per_second > 0)) {
+        throw std::runtime_error("BATTLESHIP_RATE_LIMIT: bucket-size and refill-per-second must be positive");
+    }
+    if (config.refill_per_second > 1e9) {
+        throw std::runtime_error("BATTLESHIP_RATE_LIMIT: refill-per-second must not exceed 1e9");
+    }
+    // Checked in double before any integer conversion to stay clear of overflow
+    const double interval_ns = 1e9 / config.refill_per_second;
+    if (interval_ns * static_cast<double>(config.bucket_size) > static_cast<double>(kMaxToleranceNs)) {
+        throw std::runtime_error("BATTLESHIP_RATE_LIMIT: bucket-size / refill-per-second is too large");
+    }
+    config.interval_ns = static_cast<std::int64_t>(interval_ns);
+    config.tolerance_ns = config.interval_ns * config.bucket_size;
+    return config;
+}
+
+static RateLimitConfig ParseRateLimitConfig(const dynamic_config::DocsMap& docs_map) {
+    return docs_map.Get("BATTLESHIP_RATE_LIMIT").As<RateLimitConfig>();
+}
+
+static constexpr dynamic_config::Key<ParseRateLimitConfig> kRateLimitConfig;
+
+// Token bucket implemented as GCRA: the whole state is a single "theoretical
+// arrival time", so admission is one CAS without any locks
+class TokenBucket final {
+public:
+    bool Obtain(const RateLimitConfig& config, std::chrono::steady_clock::time_point now);
+
+private:
+    std::atomic<std::int64_t> tat_ns_{0};
+};
+
+bool TokenBucket::Obtain(const RateLimitConfig& config, std::chrono::steady_clock::time_point now) {
+    const auto interval = config.interval_ns;
+    const auto tolerance = config.tolerance_ns;
+    const std::int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now.time_since_epoch()).count();
+
+    auto tat = tat_ns_.load(std::memory_order_relaxed);
+    while (true) {
+        const auto new_tat = std::max(tat, now_ns) + interval;
+        if (new_tat - now_ns > tolerance) {
+            return false;
+        }
+        if (tat_ns_.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+struct RateLimiterStats {
+    std::atomic<std::uint64_t> passed{0};
+    std::atomic<std::uint64_t> rejected{0};
+};
+
+void DumpMetric(utils::statistics::Writer& writer, const RateLimiterStats& stats) {
+    writer["passed"] = stats.passed.load();
+    writer["rejected"] = stats.rejected.load();
+}
+
+void ResetMetric(RateLimiterStats& stats) {
+    stats.passed = 0;
+    stats.rejected = 0;
+}
+
+static const utils::statistics::MetricTag<RateLimiterStats> kRateLimiterStatsTag{"battleship.rate-limiter"};
+
+// Lookup and insertion of a bucket happen under the same shard lock, so
+// concurrent first requests of a player always share one bucket
+struct RateLimiterShard {
+    explicit RateLimiterShard(size_t way_size)
+        : buckets(way_size) { }
+
+    engine::Mutex mutex;
+    cache::LruMap<std::string, std::shared_ptr<TokenBucket>> buckets;
+};
+
+RateLimiter::RateLimiter(const components::ComponentConfig& config,
+                         const components::ComponentContext& context)
+    : components::LoggableComponentBase(config, context),
+      config_source_(context.FindComponent<components::DynamicConfig>().GetSource()),
+      stats_(context.FindComponent<components::StatisticsStorage>()
+                 .GetMetricsStorage()->GetMetric(kRateLimiterStatsTag)) {
+    const auto ways = std::max<size_t>(config["ways"].As<size_t>(16), 1);
+    const auto way_size = config["way-size"].As<size_t>(4096);
+    shards_.reserve(ways);
+    for (size_t i = 0; i < ways; ++i) {
+        shards_.push_back(std::make_unique<RateLimiterShard>(way_size));
+    }
+}
+
+RateLimiter::~RateLimiter() = default;
+
+bool RateLimiter::Allow(std::string_view endpoint, std::string_view player_id) {
+    const auto limits = config_source_.GetCopy(kRateLimitConfig);
+    if (!limits.enabled) {
+        return true;
+    }
+
+    std::string key;
+    key.reserve(endpoint.size() + 1 + player_id.size());
+    key.append(endpoint).append(1, ':').append(player_id);
+
+    auto& shard = *shards_[std::hash<std::string>{}(key) % shards_.size()];
+    std::shared_ptr<TokenBucket> bucket;
+    {
+        std::lock_guard lock(shard.mutex);
+        if (const auto* existing_bucket = shard.buckets.Get(key)) {
+            bucket = *existing_bucket;
+        } else {
+            bucket = std::make_shared<TokenBucket>();
+            shard.buckets.Put(std::move(key), bucket);
+        }
+    }
+
+    if (!bucket->Obtain(limits, std::chrono::steady_clock::now())) {
+        ++stats_.rejected;
+        return false;
+    }
+    ++stats_.passed;
+    return true;
+}
+
+yaml_config::Schema RateLimiter::GetStaticConfigSchema() {
+    return yaml_config::MergeSchemas<components::LoggableComponentBase>(R"(
+type: object
+description: per-player token bucket limiter for the polling handlers
+additionalProperties: false
+properties:
+    ways:
+        type: integer
+        description: number of LRU shards with token buckets
+        defaultDescription: 16
+    way-size:
+        type: integer
+        description: max number of token buckets in one shard
+        defaultDescription: 4096
+)");
+}
+
+void AppendRateLimiter(userver::components::ComponentList& component_list) {
+    component_list.Append<RateLimiter>();
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <userver/components/component_list.hpp>
+#include <userver/components/loggable_component_base.hpp>
+#include <userver/dynamic_config/source.hpp>
+#include <userver/yaml_config/schema.hpp>
+
+namespace battleship {
+
+class TokenBucket;
+struct RateLimiterStats;
+struct RateLimiterShard;
+
+// Per-player admission control for the polling handlers. Every player id gets
+// its own token bucket in every endpoint, buckets live in a sharded LRU so
+// memory is bounded by ways * way-size. Limits are taken from
+// BATTLESHIP_RATE_LIMIT dynamic config.
+class RateLimiter final : public userver::components::LoggableComponentBase {
+public:
+    static constexpr std::string_view kName = "rate-limiter";
+
+    RateLimiter(const userver::components::ComponentConfig& config,
+                const userver::components::ComponentContext& context);
+
+    ~RateLimiter() override;
+
+    // Must be called before any Redis access, returns false if the request
+    // should be rejected. Endpoints never share buckets: reg_id of one player
+    // is player_id of the other one, so polling /regstatus must not spend
+    // the opponent's /trykill budget.
+    bool Allow(std::string_view endpoint, std::string_view player_id);
+
+    static userver::yaml_config::Schema GetStaticConfigSchema();
+
+private:
+    userver::dynamic_config::Source config_source_;
+    std::vector<std::unique_ptr<RateLimiterShard>> shards_;
+    RateLimiterStats& stats_;
+};
+
+void AppendRateLimiter(userver::components::ComponentList& component_list);
+
+}
+
+template <>
+inline constexpr bool userver::components::kHasValidate<battleship::RateLimiter> = true;
@@ -3,31 +3,214 @@
 #include <userver/utest/using_namespace_userver.hpp>
 #include <userver/components/minimal_server_component_list.hpp>
 #include <userver/server/handlers/http_handler_base.hpp>
+#include <userver/components/loggable_component_base.hpp>
+#include <userver/concurrent/variable.hpp>
 #include <userver/storages/redis/client.hpp>
 #include <userver/storages/redis/component.hpp>
+#include <userver/storages/redis/subscribe_client.hpp>
+#include <userver/storages/redis/subscription_token.hpp>
 #include <userver/storages/secdist/component.hpp>
 #include <userver/utils/daemon_run.hpp>
 #include <userver/utils/async.hpp>
 #include <userver/engine/sleep.hpp>
+#include <userver/logging/log.hpp>
+#include <userver/testsuite/testsuite_support.hpp>
+#include <userver/utils/periodic_task.hpp>
 
 #include <atomic>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <game/ruleset.hpp>
+#include <rate_limiter/rate_limiter.hpp>
 #include <cors.hpp>
 
 namespace battleship {
 
 static std::atomic_size_t kLastRegId = 0;
 static const std::string kRegQueue = "reg-queue";
+static const std::string kSalvoRegQueue = "reg-queue-salvo";
+
+static const std::string& RegQueue(Ruleset ruleset) {
+    return ruleset == Ruleset::Salvo ? kSalvoRegQueue : kRegQueue;
+}
+
+static constexpr size_t kHourSeconds = 3600;
+static const std::string kMatchChannel = "battleship-matches";
+static constexpr std::chrono::seconds kAccessTimeFlushInterval{1};
+static constexpr std::time_t kStorageRecheckSeconds = 10;
+
+// In-process copy of game_matcher for /regstatus. Local matches are added
+// by GameMatcher directly, matches made by other replicas arrive via redis
+// pub/sub. Last access times are collected here and written to redis in
+// one batch per flush interval. Matches unused for an hour are expired, the
+// same way CleanLoop forgets idle players.
+class MatchCache final : public components::LoggableComponentBase {
+public:
+    static constexpr std::string_view kName = "match-cache";
+
+    MatchCache(const components::ComponentConfig& config,
+               const components::ComponentContext& context);
+
+    ~MatchCache() override;
+
+    std::optional<std::string> FindEnemy(const std::string& reg_id);
+    // Redis is asked about a waiting player at most once per kStorageRecheckSeconds,
+    // in case a pub/sub message was lost or the player was matched before we started
+    bool NeedsStorageCheck(const std::string& reg_id);
+    void AddMatch(const std::string& reg_id, const std::string& reg_id_2);
+    void Erase(const std::vector<std::string>& ids);
+    void Touch(const std::string& reg_id);
+
+private:
+    void FlushAccessTimes();
+
+private:
+    struct Match {
+        std::string enemy_id;
+        std::time_t last_used = 0;
+    };
+
+    struct State {
+        std::unordered_map<std::string, Match> matches;
+        std::unordered_map<std::string, std::time_t> storage_checks;
+        std::unordered_map<std::string, std::time_t> access_times;
+    };
+
+    storages::redis::ClientPtr redis_client_;
+    storages::redis::CommandControl redis_cc_;
+    concurrent::Variable<State> state_;
+    storages::redis::SubscriptionToken subscription_;
+    utils::PeriodicTask flush_task_;
+};
+
+MatchCache::MatchCache(const components::ComponentConfig& config,
+                       const components::ComponentContext& context)
+    : components::LoggableComponentBase(config, context) {
+    auto& redis = context.FindComponent<components::Redis>("key-value-database");
+    redis_client_ = redis.GetClient("main-kv");
+    subscription_ = redis.GetSubscribeClient("main-kv")->Subscribe(
+        kMatchChannel,
+        [this](const std::string& /*channel*/, const std::string& message) {
+            const auto delimiter = message.find(':');
+            if (delimiter != std::string::npos) {
+                AddMatch(message.substr(0, delimiter), message.substr(delimiter + 1));
+            }
+        });
+    flush_task_.Start("match_cache_flush",
+                      utils::PeriodicTask::Settings(kAccessTimeFlushInterval),
+                      [this] { FlushAccessTimes(); });
+    flush_task_.RegisterInTestsuite(
+        context.FindComponent<components::TestsuiteSupport>().GetPeriodicTaskControl());
+}
+
+MatchCache::~MatchCache() {
+    flush_task_.Stop();
+    subscription_.Unsubscribe();
+    try {
+        FlushAccessTimes();
+    } catch (const std::exception& e) {
+        LOG_ERROR() << "Failed to flush access times: " << e;
+    }
+}
+
+std::optional<std::string> MatchCache::FindEnemy(const std::string& reg_id) {
+    const auto now = std::time(nullptr);
+    auto state = state_.Lock();
+    const auto it = state->matches.find(reg_id);
+    if (it == state->matches.end()) {
+        return std::nullopt;
+    }
+    it->second.last_used = now;
+    return it->second.enemy_id;
+}
+
+bool MatchCache::NeedsStorageCheck(const std::string& reg_id) {
+    const auto now = std::time(nullptr);
+    auto state = state_.Lock();
+    auto& last_check = state->storage_checks[reg_id];
+    if (now - last_check < kStorageRecheckSeconds) {
+        return false;
+    }
+    last_check = now;
+    return true;
+}
+
+void MatchCache::AddMatch(const std::string& reg_id, const std::string& reg_id_2) {
+    const auto now = std::time(nullptr);
+    auto state = state_.Lock();
+    state->matches[reg_id] = {reg_id_2, now};
+    state->matches[reg_id_2] = {reg_id, now};
+    state->storage_checks.erase(reg_id);
+    state->storage_checks.erase(reg_id_2);
+}
+
+void MatchCache::Erase(const std::vector<std::string>& ids) {
+    auto state = state_.Lock();
+    for (const auto& id : ids) {
+        state->matches.erase(id);
+        state->storage_checks.erase(id);
+    }
+}
+
+void MatchCache::Touch(const std::string& reg_id) {
+    const auto now = std::time(nullptr);
+    state_.Lock()->access_times[reg_id] = now;
+}
+
+void MatchCache::FlushAccessTimes() {
+    std::unordered_map<std::string, std::time_t> access_times;
+    {
+        auto state = state_.Lock();
+        access_times.swap(state->access_times);
+
+        // Idle players are forgotten together with their redis data. Matches
+        // that came via pub/sub may never reach our CleanLoop, so they expire here too
+        const auto now = std::time(nullptr);
+        const auto is_expired = [now](std::time_t time) {
+            return now - time > static_cast<std::time_t>(kHourSeconds);
+        };
+        for (auto it = state->storage_checks.begin(); it != state->storage_checks.end();) {
+            if (is_expired(it->second)) {
+                it = state->storage_checks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto it = state->matches.begin(); it != state->matches.end();) {
+            if (is_expired(it->second.last_used)) {
+                it = state->matches.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (access_times.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> values;
+    values.reserve(access_times.size());
+    for (const auto& [reg_id, time] : access_times) {
+        values.emplace_back(reg_id, std::to_string(time));
+    }
+    redis_client_->Hmset("time", std::move(values), redis_cc_).Get();
+}
 
 class GameMatcher {
 public:
     GameMatcher(storages::redis::ClientPtr redis_client,
+                MatchCache& match_cache,
                 engine::TaskProcessor& task_processor);
     
     ~GameMatcher();
 private:
-    static void MatchLoop(storages::redis::ClientPtr redis_client, std::atomic_bool* is_stop);
-    static void CleanLoop(storages::redis::ClientPtr redis_client, std::atomic_bool* is_stop);
+    static void MatchLoop(storages::redis::ClientPtr redis_client, MatchCache* match_cache,
+                          std::atomic_bool* is_stop);
+    static void CleanLoop(storages::redis::ClientPtr redis_client, MatchCache* match_cache,
+                          std::atomic_bool* is_stop);
 private:
     engine::TaskWithResult<void> match_loop_;
     engine::TaskWithResult<void> clean_loop_;
@@ -35,16 +218,19 @@ private:
 };
 
 GameMatcher::GameMatcher(storages::redis::ClientPtr redis_client,
+                         MatchCache& match_cache,
                          engine::TaskProcessor& task_processor) {
     match_loop_ = utils::CriticalAsync(task_processor,
                                        "matcher_loop",
                                        this->MatchLoop,
                                        redis_client,
+                                       &match_cache,
                                        &is_stop_);
     clean_loop_ = utils::CriticalAsync(task_processor,
                                        "matcher_loop",
                                        this->CleanLoop,
                                        redis_client,
+                                       &match_cache,
                                        &is_stop_);
 }
 
@@ -53,29 +239,46 @@ GameMatcher::~GameMatcher() {
 }
 
 void GameMatcher::MatchLoop(storages::redis::ClientPtr redis_client,
+                            MatchCache* match_cache,
                             std::atomic_bool* is_stop) {
     storages::redis::CommandControl redis_cc;
     while (!is_stop->load()) {
-        const auto reg_id = redis_client->Lpop(kRegQueue, redis_cc).Get();
-        if (reg_id.has_value()) {
-            auto reg_id_2 = redis_client->Lpop(kRegQueue, redis_cc).Get();
-            while (!reg_id_2.has_value()) {
-                engine::SleepFor(std::chrono::seconds(3));
-                reg_id_2 = redis_client->Lpop(kRegQueue, redis_cc).Get();
+        for (const auto ruleset : kRulesets) {
+            const auto& queue = RegQueue(ruleset);
+            const auto reg_id = redis_client->Lpop(queue, redis_cc).Get();
+            if (!reg_id.has_value()) {
+                continue;
+            }
+            const auto reg_id_2 = redis_client->Lpop(queue, redis_cc).Get();
+            if (!reg_id_2.has_value()) {
+                // Nobody to play with yet, return the player to the head of the queue
+                redis_client->Lpush(queue, reg_id.value(), redis_cc);
+                continue;
             }
 
-            redis_client->Hset("turn", reg_id.value(), "0", redis_cc);
-            redis_client->Hset("turn", reg_id_2.value(), "1", redis_cc);
-            redis_client->Hset("game_matcher", reg_id.value(), reg_id_2.value(), redis_cc);
-            redis_client->Hset("game_matcher", reg_id_2.value(), reg_id.value(), redis_cc);
+            auto turn_request = redis_client->Hset("turn", reg_id.value(), "0", redis_cc);
+            auto turn_request_2 = redis_client->Hset("turn", reg_id_2.value(), "1", redis_cc);
+            auto matcher_request = redis_client->Hset("game_matcher", reg_id.value(), reg_id_2.value(), redis_cc);
+            auto matcher_request_2 = redis_client->Hset("game_matcher", reg_id_2.value(), reg_id.value(), redis_cc);
+            auto version_request = redis_client->Hincrby("version", reg_id.value(), 1, redis_cc);
+            auto version_request_2 = redis_client->Hincrby("version", reg_id_2.value(), 1, redis_cc);
+            // The match becomes visible through the cache and pub/sub only
+            // after redis has it, so /sendfield and /trykill can rely on it
+            turn_request.Get();
+            turn_request_2.Get();
+            matcher_request.Get();
+            matcher_request_2.Get();
+            version_request.Get();
+            version_request_2.Get();
+            match_cache->AddMatch(reg_id.value(), reg_id_2.value());
+            redis_client->Publish(kMatchChannel, reg_id.value() + ':' + reg_id_2.value(), redis_cc);
         }
         engine::SleepFor(std::chrono::seconds(3));
     }
 }
 
-static constexpr size_t kHourSeconds = 3600;
-
 void GameMatcher::CleanLoop(storages::redis::ClientPtr redis_client,
+                            MatchCache* match_cache,
                             std::atomic_bool* is_stop) {
     storages::redis::CommandControl redis_cc;
     while (!is_stop->load()) {
@@ -92,6 +295,9 @@ void GameMatcher::CleanLoop(storages::redis::ClientPtr redis_client,
             redis_client->Hdel("turn", ids_to_remove, redis_cc);
             redis_client->Hdel("game", ids_to_remove, redis_cc);
             redis_client->Hdel("game_matcher", ids_to_remove, redis_cc);
+            redis_client->Hdel("mode", ids_to_remove, redis_cc);
+            redis_client->Hdel("version", ids_to_remove, redis_cc);
+            match_cache->Erase(ids_to_remove);
         }
     }
 }
@@ -112,7 +318,9 @@ public:
 private:
     storages::redis::ClientPtr redis_client_;
     storages::redis::CommandControl redis_cc_;
+    MatchCache& match_cache_;
     GameMatcher game_matcher_;
+    const Cors& cors_;
 };
 
 Registrator::Registrator(const components::ComponentConfig& config,
@@ -121,14 +329,25 @@ Registrator::Registrator(const components::ComponentConfig& config,
       redis_client_{
           context.FindComponent<components::Redis>("key-value-database")
             .GetClient("main-kv")},
-      game_matcher_(redis_client_, context.GetTaskProcessor("main-task-processor")) { }
+      match_cache_(context.FindComponent<MatchCache>()),
+      game_matcher_(redis_client_, match_cache_, context.GetTaskProcessor("main-task-processor")),
+      cors_(context.FindComponent<Cors>()) { }
 
 std::string Registrator::HandleRequestThrow(const server::http::HttpRequest& request,
                                             server::request::RequestContext& /*context*/) const {
-    SetCors(request);
+    cors_.SetHeaders(request);
+    const auto& mode = request.GetArg("mode");
+    const auto ruleset = mode.empty() ? Ruleset::Classic : ParseRuleset(mode);
+    if (!ruleset.has_value()) {
+        return "Wrong mode";
+    }
+
     const auto reg_id = std::to_string(kLastRegId++);
-    redis_client_->Rpush(kRegQueue, reg_id, redis_cc_);
-    redis_client_->Hset("time", reg_id, std::to_string(std::time(nullptr)), redis_cc_);
+    if (ruleset != Ruleset::Classic) {
+        redis_client_->Hset("mode", reg_id, std::string(ToString(*ruleset)), redis_cc_);
+    }
+    redis_client_->Rpush(RegQueue(*ruleset), reg_id, redis_cc_);
+    match_cache_.Touch(reg_id);
 
     return reg_id;
 }
@@ -149,6 +368,9 @@ public:
 private:
     storages::redis::ClientPtr redis_client_;
     storages::redis::CommandControl redis_cc_;
+    RateLimiter& rate_limiter_;
+    MatchCache& match_cache_;
+    const Cors& cors_;
 };
 
 RegStatus::RegStatus(const components::ComponentConfig& config,
@@ -156,23 +378,38 @@ RegStatus::RegStatus(const components::ComponentConfig& config,
     : server::handlers::HttpHandlerBase(config, context),
       redis_client_{
           context.FindComponent<components::Redis>("key-value-database")
-            .GetClient("main-kv")} { }
+            .GetClient("main-kv")},
+      rate_limiter_(context.FindComponent<RateLimiter>()),
+      match_cache_(context.FindComponent<MatchCache>()),
+      cors_(context.FindComponent<Cors>()) { }
 
 std::string RegStatus::HandleRequestThrow(const server::http::HttpRequest& request,
                                           server::request::RequestContext& /*context*/) const {
-    SetCors(request);
+    cors_.SetHeaders(request);
     const auto& reg_id = request.GetArg("reg_id");
     if (reg_id.empty()) {
         return "Can't find reg_id arg";
     }
-    const auto& player_id = redis_client_->Hget("game_matcher", reg_id, redis_cc_).Get();
-    redis_client_->Hset("time", reg_id, std::to_string(std::time(nullptr)), redis_cc_);
+    if (!rate_limiter_.Allow(kName, reg_id)) {
+        request.SetResponseStatus(server::http::HttpStatus::kTooManyRequests);
+        return "Too many requests";
+    }
+    match_cache_.Touch(reg_id);
+
+    auto player_id = match_cache_.FindEnemy(reg_id);
+    if (!player_id.has_value() && match_cache_.NeedsStorageCheck(reg_id)) {
+        player_id = redis_client_->Hget("game_matcher", reg_id, redis_cc_).Get();
+        if (player_id.has_value()) {
+            match_cache_.AddMatch(reg_id, *player_id);
+        }
+    }
 
     return player_id.value_or("Wait");
 }
 
 void AppendRegistrator(userver::components::ComponentList& component_list) {
-    component_list.Append<Registrator>()
+    component_list.Append<MatchCache>()
+                  .Append<Registrator>()
                   .Append<RegStatus>();
 }
 
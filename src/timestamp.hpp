@@ -0,0 +1,21 @@
+#pragma once
+
+#include <charconv>
+#include <ctime>
+#include <limits>
+#include <string>
+
+// Unix time as a string, rebuilt at most once per second on each thread.
+// The result is thread local, copy it before the coroutine can be suspended.
+inline const std::string& CurrentTimestamp() {
+    thread_local std::time_t cached_time = 0;
+    thread_local std::string cached_str;
+    const auto now = std::time(nullptr);
+    if (now != cached_time) {
+        char buffer[std::numeric_limits<std::time_t>::digits10 + 2];
+        const auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer), now);
+        cached_str.assign(buffer, end);
+        cached_time = now;
+    }
+    return cached_str;
+}
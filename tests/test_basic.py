@@ -1,6 +1,8 @@
 import time
 import json
 
+import pytest
+
 
 # Start via `make test-debug` or `make test-release`
 async def test_basic(service_client):
@@ -78,3 +80,244 @@ async def test_basic(service_client):
     response = await service_client.get('/trykill?player_id=0&x=0&y=0')
     assert response.status == 200
     assert response.text == 'You lose'
+
+
+async def test_salvo(service_client):
+    field = {'left_field': {
+        'field': [
+            [0, 0, 0, 0, 0, 0, 0, 1, 1, 1],
+            [1, 0, 1, 0, 0, 0, 0, 0, 0, 0],
+            [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+            [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+            [0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+            [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+            [1, 1, 0, 0, 0, 0, 0, 1, 0, 1],
+            [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+            [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+            [0, 1, 0, 0, 1, 0, 0, 1, 0, 1]]}}
+
+    response = await service_client.get('/regnewgame?mode=salvo')
+    assert response.status == 200
+    first_id = response.text
+
+    response = await service_client.get('/regnewgame?mode=salvo')
+    assert response.status == 200
+    second_id = response.text
+
+    time.sleep(5)
+
+    response = await service_client.get(
+            '/regstatus?reg_id={}'.format(first_id))
+    assert response.status == 200
+    assert response.text == second_id
+
+    for player_id in [first_id, second_id]:
+        response = await service_client.post(
+                '/sendfield?player_id={}'.format(player_id),
+                data=json.dumps(field))
+        assert response.status == 200
+
+    response = await service_client.get(
+            '/trykill?player_id={}&x=0&y=0'.format(second_id))
+    assert response.status == 200
+    assert response.text == 'Wrong game mode'
+
+    response = await service_client.get(
+            '/trykill?player_id={}&shots=0:0,1:0,0:7,0:8,0:9'.format(
+                second_id))
+    assert response.status == 200
+    assert response.json() == {
+        'shots': [
+            {'x': 0, 'y': 0, 'result': 'Miss'},
+            {'x': 1, 'y': 0, 'result': 'Kill'},
+            {'x': 0, 'y': 7, 'result': 'Damage'},
+            {'x': 0, 'y': 8, 'result': 'Damage'},
+            {'x': 0, 'y': 9, 'result': 'Kill'},
+        ],
+        'result': 'Kill',
+    }
+
+    response = await service_client.get(
+            '/trykill?player_id={}&shots=0:0'.format(second_id))
+    assert response.status == 200
+    assert response.text == 'Not your turn'
+
+    response = await service_client.get(
+            '/trykill?player_id={}&shots={}'.format(
+                first_id, ','.join(['0:0'] * 11)))
+    assert response.status == 200
+    assert response.text == 'wrong shots count'
+
+
+async def test_gamestate(service_client):
+    field = [
+        [0, 0, 0, 0, 0, 0, 0, 1, 1, 1],
+        [1, 0, 1, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [1, 1, 0, 0, 0, 0, 0, 1, 0, 1],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 1, 0, 0, 1, 0, 0, 1, 0, 1]]
+
+    first_id = (await service_client.get('/regnewgame')).text
+    second_id = (await service_client.get('/regnewgame')).text
+
+    # Nothing to cache until the player is in a game
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id),
+            headers={'If-None-Match': '"0"'})
+    assert response.status == 200
+    assert response.text == 'player_id is broken'
+    assert 'ETag' not in response.headers
+
+    time.sleep(5)
+
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id),
+            headers={'If-None-Match': '"0"'})
+    assert response.status == 200
+    matched_etag = response.headers['ETag']
+    assert matched_etag != '"0"'
+
+    for player_id in [first_id, second_id]:
+        response = await service_client.post(
+                '/sendfield?player_id={}'.format(player_id),
+                data=json.dumps({'left_field': {'field': field}}))
+        assert response.status == 200
+
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id),
+            headers={'If-None-Match': matched_etag})
+    assert response.status == 200
+    etag = response.headers['ETag']
+    state = response.json()
+    assert state['my_field']['field'] == field
+    assert state['enemy_field']['field'] == [[0] * 10] * 10
+    assert not state['your_turn']
+
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id),
+            headers={'If-None-Match': etag})
+    assert response.status == 304
+
+    response = await service_client.get(
+            '/trykill?player_id={}&x=0&y=0'.format(second_id))
+    assert response.text == 'Miss'
+
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id),
+            headers={'If-None-Match': etag})
+    assert response.status == 200
+    assert response.headers['ETag'] != etag
+    state = response.json()
+    assert state['my_field']['field'][0][0] == 3
+    assert state['your_turn']
+
+
+@pytest.mark.config(BATTLESHIP_RATE_LIMIT={
+    'enabled': True,
+    'bucket-size': 2,
+    'refill-per-second': 0.001,
+})
+async def test_rate_limit(service_client, monitor_client, redis_store):
+    await service_client.reset_metrics()
+    url = '/trykill?player_id=rate-limited&x=0&y=0'
+
+    for _ in range(2):
+        response = await service_client.get(url)
+        assert response.status == 200
+        assert response.text == 'your field is broken'
+    assert redis_store.hget('time', 'rate-limited') is not None
+
+    redis_store.hdel('time', 'rate-limited')
+    for _ in range(3):
+        response = await service_client.get(url)
+        assert response.status == 429
+    assert redis_store.hget('time', 'rate-limited') is None
+
+    metric = await monitor_client.single_metric('battleship.rate-limiter.rejected')
+    assert metric.value == 3
+
+
+
+@pytest.mark.config(BATTLESHIP_RATE_LIMIT={
+    'enabled': True,
+    'bucket-size': 2,
+    'refill-per-second': 0.001,
+})
+async def test_rate_limit_per_endpoint(service_client):
+    # reg_id of one player is player_id of the other one
+    for _ in range(2):
+        response = await service_client.get('/regstatus?reg_id=shared-id')
+        assert response.status == 200
+    for _ in range(3):
+        response = await service_client.get('/regstatus?reg_id=shared-id')
+        assert response.status == 429
+
+    for _ in range(2):
+        response = await service_client.get(
+                '/trykill?player_id=shared-id&x=0&y=0')
+        assert response.status == 200
+        assert response.text == 'your field is broken'
+
+async def test_regstatus_cache(service_client, redis_store):
+    first_id = (await service_client.get('/regnewgame')).text
+    second_id = (await service_client.get('/regnewgame')).text
+
+    time.sleep(5)
+
+    await service_client.suspend_periodic_tasks(['match_cache_flush'])
+    try:
+        await service_client.run_periodic_task('match_cache_flush')
+        redis_store.hdel('time', first_id)
+        # The match is answered from memory without game_matcher in redis
+        redis_store.hdel('game_matcher', first_id)
+
+        for _ in range(3):
+            response = await service_client.get(
+                    '/regstatus?reg_id={}'.format(first_id))
+            assert response.status == 200
+            assert response.text == second_id
+
+        # Access times wait for the next flush instead of a write per poll
+        assert redis_store.hget('time', first_id) is None
+        await service_client.run_periodic_task('match_cache_flush')
+        assert redis_store.hget('time', first_id) is not None
+    finally:
+        await service_client.resume_periodic_tasks(['match_cache_flush'])
+
+
+async def test_sendfield_stores_validated_field(service_client):
+    field = [
+        [0, 0, 0, 0, 0, 0, 0, 1, 1, 1],
+        [1, 0, 1, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+        [0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+        [1, 1, 0, 0, 0, 0, 0, 1, 0, 1],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 0, 0, 0, 1, 0, 0, 1, 0, 0],
+        [0, 1, 0, 0, 1, 0, 0, 1, 0, 1]]
+    decoy = [[1] * 10] * 10
+
+    first_id = (await service_client.get('/regnewgame')).text
+    (await service_client.get('/regnewgame')).text
+
+    time.sleep(5)
+
+    response = await service_client.post(
+            '/sendfield?player_id={}'.format(first_id),
+            data=json.dumps({'left_field': {
+                'decoy': {'field': decoy},
+                'field': field}}))
+    assert response.status == 200
+    assert response.json()['status']
+
+    response = await service_client.get(
+            '/gamestate?player_id={}'.format(first_id))
+    assert response.status == 200
+    assert response.json()['my_field']['field'] == field